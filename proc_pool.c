@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proc_pool.h"
+
+// slabs are chained together so they can all be freed at the end of a run
+typedef struct slab {
+    struct slab *next;
+    proc_t slots[PROC_SLAB_SIZE];
+} slab_t;
+
+static slab_t *slabs;
+static proc_t *free_slots;     // linked through each process's runqueue link
+
+
+// allocate a fresh slab and thread all of its slots onto the free list
+static void grow_pool() {
+    slab_t *slab = malloc(sizeof(slab_t));
+    if (!slab) {
+        fprintf(stderr, "Out of memory allocating process slab\n");
+        exit(EXIT_FAILURE);
+    }
+    slab->next = slabs;
+    slabs = slab;
+    for (int i = PROC_SLAB_SIZE - 1; i >= 0; i--) {
+        slab->slots[i].next = free_slots;
+        free_slots = &slab->slots[i];
+    }
+}
+
+// hand out a zeroed process slot, recycling terminated ones first
+proc_t *proc_alloc() {
+    if (!free_slots) {
+        grow_pool();
+    }
+    proc_t *proc = free_slots;
+    free_slots = proc->next;
+    memset(proc, 0, sizeof(proc_t));
+    return proc;
+}
+
+// return a terminated process's slot to the free list
+void proc_release(proc_t *proc) {
+    proc->next = free_slots;
+    free_slots = proc;
+}
+
+// free every slab; all outstanding processes become invalid
+void proc_pool_destroy() {
+    while (slabs) {
+        slab_t *next = slabs->next;
+        free(slabs);
+        slabs = next;
+    }
+    free_slots = NULL;
+}
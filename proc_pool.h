@@ -0,0 +1,13 @@
+#ifndef SCHEDULER_PROC_POOL_H
+#define SCHEDULER_PROC_POOL_H
+
+#include "reporter.h"
+
+// number of process slots carved out of each slab
+#define PROC_SLAB_SIZE  4096
+
+proc_t *proc_alloc();
+void proc_release(proc_t *proc);
+void proc_pool_destroy();
+
+#endif //SCHEDULER_PROC_POOL_H
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "reporter.h"
 
 #define PRIORITY_HIGH   3
@@ -37,62 +38,201 @@ void print_status_line(long time_elapsed,
     free(iostring);
 }
 
-// report stats at the end of a simulation: throughput, number of context switches,
-// average wait time for each priority class,...
-void report(long cpu_in_use, long cpu_idle, int context_switches,
-                  int nr_processes,
-                  proc_t **processes) {
+// fold a terminated process into the running totals
+void record_process(stats_t *stats, proc_t *proc) {
+    switch (proc->priority) {
+        case PRIORITY_HIGH:
+            stats->high_wait_time += proc->wait_time;
+            stats->nr_high_procs++;
+            break;
+        case PRIORITY_MED:
+            stats->med_wait_time += proc->wait_time;
+            stats->nr_med_procs++;
+            break;
+        case PRIORITY_LOW:
+            stats->low_wait_time += proc->wait_time;
+            stats->nr_low_procs++;
+            break;
+    }
+    stats->overall_wait_time += proc->wait_time;
+    stats->nr_processes++;
+}
 
-    int turn_time = 0;
+// two-sided 95% Student t quantiles for 1..MAX_BATCHES - 1 degrees of freedom
+static const double t_quantiles[MAX_BATCHES - 1] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+        2.040, 2.037, 2.035, 2.032, 2.030, 2.028, 2.026, 2.024, 2.023, 2.021,
+        2.020, 2.018, 2.017, 2.015, 2.014, 2.013, 2.012, 2.011, 2.010, 2.009,
+        2.008, 2.007, 2.006, 2.005, 2.004, 2.003, 2.002, 2.002, 2.001, 2.000,
+        2.000, 1.999, 1.998
+};
+
+// add one set of totals to another
+static void add_stats(stats_t *to, stats_t *from) {
+    to->nr_processes += from->nr_processes;
+    to->nr_high_procs += from->nr_high_procs;
+    to->nr_med_procs += from->nr_med_procs;
+    to->nr_low_procs += from->nr_low_procs;
+    to->high_wait_time += from->high_wait_time;
+    to->med_wait_time += from->med_wait_time;
+    to->low_wait_time += from->low_wait_time;
+    to->overall_wait_time += from->overall_wait_time;
+}
 
-    int nr_high_procs = 0,
-        nr_med_procs = 0,
-        nr_low_procs = 0;
+// average of a metric over one batch. Returns 0 if the batch has no sample,
+// e.g. no processes of a priority class
+static int batch_mean(batch_t *batch, int metric, double *mean) {
+    stats_t *stats = &batch->stats;
+    switch (metric) {
+        case METRIC_HIGH_WAIT:
+            if (!stats->nr_high_procs) return 0;
+            *mean = (double) stats->high_wait_time / stats->nr_high_procs;
+            return 1;
+        case METRIC_MED_WAIT:
+            if (!stats->nr_med_procs) return 0;
+            *mean = (double) stats->med_wait_time / stats->nr_med_procs;
+            return 1;
+        case METRIC_LOW_WAIT:
+            if (!stats->nr_low_procs) return 0;
+            *mean = (double) stats->low_wait_time / stats->nr_low_procs;
+            return 1;
+        case METRIC_OVERALL_WAIT:
+            if (!stats->nr_processes) return 0;
+            *mean = (double) stats->overall_wait_time / stats->nr_processes;
+            return 1;
+        case METRIC_UTILISATION:
+            if (!(batch->busy + batch->idle)) return 0;
+            *mean = (double) (batch->busy * 100) / (batch->busy + batch->idle);
+            return 1;
+        default:
+            return 0;
+    }
+}
 
-    int high_wait_time = 0,
-        low_wait_time = 0,
-        med_wait_time = 0,
-        overall_wait_time = 0;
+// batch-means estimate of a metric over the completed batches
+estimate_t estimate(batches_t *batches, int metric) {
+    estimate_t est = {0, 0, INFINITY, 0};
+    double x[MAX_BATCHES];
+    for (int i = 0; i < batches->nr_batches; i++) {
+        if (batch_mean(&batches->done[i], metric, &x[est.n])) {
+            est.mean += x[est.n++];
+        }
+    }
+    if (est.n < 2) {
+        return est;
+    }
+    est.mean /= est.n;
 
-    double avg_high_wait_time,
-           avg_med_wait_time,
-           avg_low_wait_time,
-           avg_overall_wait_time;
+    double var = 0, cov = 0;
+    for (int i = 0; i < est.n; i++) {
+        var += (x[i] - est.mean) * (x[i] - est.mean);
+        if (i + 1 < est.n) {
+            cov += (x[i] - est.mean) * (x[i + 1] - est.mean);
+        }
+    }
+    int df = est.n - 1;
+    double t = t_quantiles[df - 1];
+    est.half_width = t * sqrt(var / df / est.n);
+    est.lag1 = var ? cov / var : 0;
+    return est;
+}
 
+// begin the first batch, e.g. at the end of the warm-up period
+void start_batches(batches_t *batches, long batch_size, long cpu_in_use, long cpu_idle) {
+    memset(batches, 0, sizeof(batches_t));
+    batches->batch_size = batch_size;
+    batches->busy_start = cpu_in_use;
+    batches->idle_start = cpu_idle;
+}
 
-    for (int i = 0; i < nr_processes; i++) {
-        proc_t *proc = processes[i];
-        switch (proc->priority) {
-            case PRIORITY_HIGH:
-                high_wait_time += proc->wait_time;
-                nr_high_procs++;
-                break;
-            case PRIORITY_MED:
-                med_wait_time += proc->wait_time;
-                nr_med_procs++;
-                break;
-            case PRIORITY_LOW:
-                low_wait_time += proc->wait_time;
-                nr_low_procs++;
-                break;
+// fold a terminated process into the current batch. Returns 1 if this closed
+// the batch, the only time batches_converged() can change
+int record_batch(batches_t *batches, proc_t *proc, long cpu_in_use, long cpu_idle) {
+    batch_t *batch = &batches->current;
+    record_process(&batch->stats, proc);
+    if (batch->stats.nr_processes < batches->batch_size) {
+        return 0;
+    }
+    batch->busy = cpu_in_use - batches->busy_start;
+    batch->idle = cpu_idle - batches->idle_start;
+    batches->done[batches->nr_batches++] = *batch;
+
+    // out of room: merge neighbouring batches, doubling the batch size. The
+    // array is full, so every merged batch holds the same number of processes
+    if (batches->nr_batches == MAX_BATCHES) {
+        for (int i = 0; i < MAX_BATCHES / 2; i++) {
+            batch_t *merged = &batches->done[i];
+            *merged = batches->done[2 * i];
+            add_stats(&merged->stats, &batches->done[2 * i + 1].stats);
+            merged->busy += batches->done[2 * i + 1].busy;
+            merged->idle += batches->done[2 * i + 1].idle;
         }
-        overall_wait_time += proc->wait_time;
-        turn_time += processes[i]->end_time;
+        batches->nr_batches = MAX_BATCHES / 2;
+        batches->batch_size *= 2;
     }
 
-    avg_high_wait_time = ((double)high_wait_time) / nr_high_procs;
-    avg_med_wait_time = ((double)med_wait_time) / nr_med_procs;
-    avg_low_wait_time = ((double)low_wait_time) / nr_low_procs;
-    avg_overall_wait_time = ((double)overall_wait_time) / nr_processes;
+    memset(batch, 0, sizeof(batch_t));
+    batches->busy_start = cpu_in_use;
+    batches->idle_start = cpu_idle;
+    return 1;
+}
+
+// true once HIGH priority and overall average wait times are both known to
+// within 'precision' (relative half-width of the 95% confidence interval),
+// over batches long enough for their means to be close to uncorrelated
+int batches_converged(batches_t *batches, double precision) {
+    int metrics[] = {METRIC_HIGH_WAIT, METRIC_OVERALL_WAIT};
+    for (int i = 0; i < 2; i++) {
+        estimate_t est = estimate(batches, metrics[i]);
+        if (est.n < MIN_BATCHES || est.lag1 > MAX_LAG1
+            || est.half_width > precision * est.mean) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// report stats at the end of a simulation: throughput, number of context switches,
+// average wait time for each priority class,... When 'batches' is given, each
+// average is followed by the half-width of its 95% confidence interval
+void report(long cpu_in_use, long cpu_idle, int context_switches,
+                  stats_t *stats, batches_t *batches) {
+
+    double avg_high_wait_time,
+           avg_med_wait_time,
+           avg_low_wait_time,
+           avg_overall_wait_time;
+
+    avg_high_wait_time = ((double)stats->high_wait_time) / stats->nr_high_procs;
+    avg_med_wait_time = ((double)stats->med_wait_time) / stats->nr_med_procs;
+    avg_low_wait_time = ((double)stats->low_wait_time) / stats->nr_low_procs;
+    avg_overall_wait_time = ((double)stats->overall_wait_time) / stats->nr_processes;
 
     printf("   CPU Busy Time: %ld\n", cpu_in_use);
     printf("   CPU Idle Time: %ld\n", cpu_idle);
-    printf("   Avg. Throughput: %f\n", ((double )(cpu_in_use * 100) / (cpu_idle + cpu_in_use)));
-    printf("   Avg. Wait times:\n");
-    printf("    |-HIGH    : %f\n", avg_high_wait_time);
-    printf("    |-MED     : %f\n", avg_med_wait_time);
-    printf("    |-LOW     : %f\n", avg_low_wait_time);
-    printf("    |-OVERALL : %f\n", avg_overall_wait_time);
+    if (!batches) {
+        printf("   Avg. Throughput: %f\n", ((double )(cpu_in_use * 100) / (cpu_idle + cpu_in_use)));
+        printf("   Avg. Wait times:\n");
+        printf("    |-HIGH    : %f\n", avg_high_wait_time);
+        printf("    |-MED     : %f\n", avg_med_wait_time);
+        printf("    |-LOW     : %f\n", avg_low_wait_time);
+        printf("    |-OVERALL : %f\n", avg_overall_wait_time);
+    } else {
+        printf("   Avg. Throughput: %f +/- %f\n", ((double )(cpu_in_use * 100) / (cpu_idle + cpu_in_use)),
+               estimate(batches, METRIC_UTILISATION).half_width);
+        printf("   Avg. Wait times (95%% CI over %d batches of %ld, lag-1 correlation %.2f):\n",
+               batches->nr_batches, batches->batch_size, estimate(batches, METRIC_OVERALL_WAIT).lag1);
+        printf("    |-HIGH    : %f +/- %f\n", avg_high_wait_time,
+               estimate(batches, METRIC_HIGH_WAIT).half_width);
+        printf("    |-MED     : %f +/- %f\n", avg_med_wait_time,
+               estimate(batches, METRIC_MED_WAIT).half_width);
+        printf("    |-LOW     : %f +/- %f\n", avg_low_wait_time,
+               estimate(batches, METRIC_LOW_WAIT).half_width);
+        printf("    |-OVERALL : %f +/- %f\n", avg_overall_wait_time,
+               estimate(batches, METRIC_OVERALL_WAIT).half_width);
+    }
     printf("   Context Switches: %d\n", context_switches);
 
 
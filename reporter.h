@@ -2,36 +2,97 @@
 #define SCHEDULER_REPORTER_H
 
 typedef struct process {
+    struct process *next;   // runqueue link, or free list link in the process pool
+
+    long wait_time;         // total time spent in ready state
+    long arrival_time;      // time at which process is created
+
     int id;
-    int priority;
-    int state;
-
-    int start_time;
-    int end_time;
-    int wait_time;
-
-    int burst_time;         // total time spend on CPU
-    int arrival_time;       // time at which process is created
-    int response_time;      // interval between process creation and first run on CPU
-    int waiting_time;       // total time spent in ready state
-    int turnaround_time;    // interval between process creation and termination
-
-    int burst_countdown;
-    int io_countdown;
-    int quantum_countdown;  // depends on scheduling algorithm
-    int cpu_burst;          // range from ? to ?, distribution based on ?
-    int io_burst;           // range from ? to ?
-    int reps;               // should be random
+    signed char priority;
+    signed char state;
+
+    // bursts are at most a few hundred ticks, so shorts keep slots small
+    short burst_countdown;
+    short io_countdown;
+    short quantum_countdown;  // depends on scheduling algorithm
+    short cpu_burst;          // range from ? to ?, distribution based on ?
+    short io_burst;           // range from ? to ?
+    short reps;               // should be random
 } proc_t;
 
+// running totals over terminated processes: everything report() needs,
+// so processes can be discarded as soon as they finish
+typedef struct stats {
+    long nr_processes;
+    long nr_high_procs;
+    long nr_med_procs;
+    long nr_low_procs;
+
+    long long high_wait_time;
+    long long med_wait_time;
+    long long low_wait_time;
+    long long overall_wait_time;
+} stats_t;
+
+// batch means: terminated processes are grouped into batches, and the spread of
+// the per-batch averages gives the confidence interval on each average in
+// report(). Batches are only trusted once there are MIN_BATCHES of them and
+// neighbouring batch means are close to uncorrelated; until then the run goes
+// on, and whenever MAX_BATCHES are full neighbouring batches are merged,
+// doubling the batch size
+#define BATCH_SIZE      1000    // initial terminated processes per batch
+#define MIN_BATCHES     20
+#define MAX_BATCHES     64
+#define MAX_LAG1        0.2     // largest lag-1 autocorrelation of batch means accepted
+
+// metrics estimated by batch means
+#define METRIC_HIGH_WAIT        0
+#define METRIC_MED_WAIT         1
+#define METRIC_LOW_WAIT         2
+#define METRIC_OVERALL_WAIT     3
+#define METRIC_UTILISATION      4
+
+typedef struct batch {
+    stats_t stats;
+    long busy;
+    long idle;
+} batch_t;
+
+typedef struct batches {
+    long batch_size;
+    int nr_batches;         // completed batches in 'done'
+    batch_t current;        // the batch being filled
+    long busy_start;        // CPU counters when the current batch started
+    long idle_start;
+    batch_t done[MAX_BATCHES];
+} batches_t;
+
+// a metric's batch-means estimate: 95% confidence interval half-width and the
+// lag-1 autocorrelation of its batch means
+typedef struct estimate {
+    int n;
+    double mean;
+    double half_width;
+    double lag1;
+} estimate_t;
+
 void print_status_line(long time_elapsed,
                        int nr_processes,
                        proc_t **processes,
                        proc_t *live_proc);
 
+void record_process(stats_t *stats, proc_t *proc);
+
+void start_batches(batches_t *batches, long batch_size, long cpu_in_use, long cpu_idle);
+
+int record_batch(batches_t *batches, proc_t *proc, long cpu_in_use, long cpu_idle);
+
+estimate_t estimate(batches_t *batches, int metric);
+
+int batches_converged(batches_t *batches, double precision);
+
 void report(long cpu_in_use, long cpu_idle, int context_switches,
-                  int nr_processes,
-                  proc_t **processes);
+                  stats_t *stats, batches_t *batches);
 
 void print_process_info(proc_t *proc);
 
@@ -2,13 +2,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include "reporter.h"
 #include "traffic_generator.h"
+#include "proc_pool.h"
 
 #define NR_SCHED_ALGS   2
 
 #define QUANTUM         5
 
+#define WARMUP          10000   // default ticks discarded before measuring an open-loop run
+#define PRECISION       0.05    // default relative CI half-width at which an open-loop run stops
+
 #define PRIORITY_HIGH   3
 #define PRIORITY_MED    2
 #define PRIORITY_LOW    1
@@ -19,21 +27,32 @@
 #define TERMINATED      -1
 
 
-// a general node used as links to implement a runqueue
-typedef struct node {
-    int priority;
-    proc_t *process;
-    struct node *next;
-} node_t;
-
-
 
 static long time_elapsed = 0;
 static int context_switches = 0; // ONLY iterated when a call to context_switch() is successful
 static long cpu_in_use = 0, cpu_idle = 0;
-static proc_t **processes;
-static int nr_processes;
+static proc_t **processes;        // resident (non-terminated) processes
+static int nr_live = 0;           // number of entries in 'processes'
+static int processes_cap = 0;     // allocated length of 'processes'
+static int nr_processes;          // processes admitted so far
+static int max_live = 0;          // multiprogramming limit, 0 = unlimited
 static int finished_processes = 0;
+static FILE *traffic;             // traffic.txt, while processes remain to be read
+static int nr_requested;          // processes to simulate
+static int traffic_exhausted = 0; // every process has been admitted
+static stats_t stats;             // totals over terminated processes
+static int arrivals = ARRIVALS_BATCH;
+static double load = 0;           // target CPU utilisation of an open-loop run
+// open-loop options; negative until set on the command line
+static long warmup = -1;          // processes arriving before this are not measured
+static double precision = -1;
+static double burstiness = -1;
+static double sojourn = -1;
+static long batch_size = BATCH_SIZE;
+static batches_t batches;         // batch means, open-loop runs only
+static int converged = 0;         // an open-loop run's averages are precise enough
+static long warmup_busy = 0, warmup_idle = 0;
+static int warmup_switches = 0;
 static proc_t *live_proc;  // points to the process running at any given time
 static char *sched_alg;
 static int sched_alg_index;
@@ -42,8 +61,9 @@ const char* sched_algs[] = {
         "RR"
 };
 
-// pointers to the head & tail of each priority level's associated queue
-static node_t *high_head, *med_head, *low_head,
+// pointers to the head & tail of each priority level's associated queue,
+// linked through each process's 'next' field
+static proc_t *high_head, *med_head, *low_head,
         *high_tail, *med_tail, *low_tail;
 
 
@@ -60,21 +80,35 @@ int valid_sched_alg(const char *s) {
 }
 
 
+// parse a whole string as an integer. Returns 0 if any of it is not a number
+int parse_long(const char *s, long *value) {
+    char *end;
+    errno = 0;
+    *value = strtol(s, &end, 10);
+    return end != s && *end == '\0' && errno == 0;
+}
+
+// parse a whole string as a finite floating point number. Returns 0 if any of it
+// is not a number
+int parse_double(const char *s, double *value) {
+    char *end;
+    errno = 0;
+    *value = strtod(s, &end);
+    return end != s && *end == '\0' && errno == 0 && isfinite(*value);
+}
+
+
 // push to a specified queue
-void push_to_runqueue(proc_t *proc, node_t **rq_head, node_t **rq_tail) {
-    // temporary link storing input process
-    node_t *proc_node = malloc(sizeof(node_t));
-    proc_node->process = proc;
-    proc_node->next = NULL;
-    proc_node->priority = proc->priority;
-
-    // if queue is empty, this link becomes the head and
-    // the tail. Otherwise, this link becomes the tail
+void push_to_runqueue(proc_t *proc, proc_t **rq_head, proc_t **rq_tail) {
+    proc->next = NULL;
+
+    // if queue is empty, this process becomes the head and
+    // the tail. Otherwise, this process becomes the tail
     if (*rq_head == NULL) {
-        *rq_head = *rq_tail = proc_node;
+        *rq_head = *rq_tail = proc;
     } else {
-        (*rq_tail)->next = proc_node;
-        *rq_tail = proc_node;
+        (*rq_tail)->next = proc;
+        *rq_tail = proc;
     }
 }
 
@@ -82,7 +116,7 @@ void push_to_runqueue(proc_t *proc, node_t **rq_head, node_t **rq_tail) {
 void push(proc_t *proc) {
     // the priority of a process determines the queue to which
     // it will be added
-    node_t **head, **tail;
+    proc_t **head, **tail;
     switch (proc->priority) {
         case PRIORITY_HIGH:
             head = &high_head;
@@ -101,106 +135,119 @@ void push(proc_t *proc) {
 }
 
 
+// poll from a specified queue
+proc_t *poll_from_runqueue(proc_t **rq_head) {
+    proc_t *popped = *rq_head;
+    if (popped != NULL) {
+        *rq_head = popped->next;
+    }
+    // NULL if queue is empty
+    return popped;
+}
+
 // poll from the highest priority nonempty queue
 proc_t *poll() {
+    proc_t *popped;
     // if high level queue isn't empty, pop from queue of HIGH priority
-    if (high_head != NULL) {
-        node_t *curr = high_head;
-        if (curr != NULL) {
-            proc_t *popped = curr->process;
-            high_head = (high_head)->next;
-            free(curr);
-            return popped;
-        }
+    if ((popped = poll_from_runqueue(&high_head))) {
+        return popped;
     }
     // otherwise, if med level queue isn't empty, pop from queue of MED priority
-    if (med_head != NULL) {
-        node_t *curr = med_head;
-        if (curr != NULL) {
-            proc_t *popped = curr->process;
-            med_head = (med_head)->next;
-            free(curr);
-            return popped;
-        }
+    if ((popped = poll_from_runqueue(&med_head))) {
+        return popped;
     }
     // otherwise, if low level queue isn't empty, pop from queue of LOW priority
-    if (low_head != NULL) {
-        node_t *curr = low_head;
-        if (curr != NULL) {
-            proc_t *popped = curr->process;
-            low_head = (low_head)->next;
-            free(curr);
-            return popped;
-        }
-    }
-    return NULL; // Otherwise, all processes are in waiting or terminated states: return NULL
+    // if all processes are in waiting or terminated states, this returns NULL
+    return poll_from_runqueue(&low_head);
 }
 
-// poll from a specified queue
-proc_t *poll_from_runqueue(node_t **rq_head) {
-    // if high level queue isn't empty, pop from queue of HIGH priority
-    if (*rq_head != NULL) {
-        node_t *curr = *rq_head;
-        if (curr != NULL) {
-            proc_t *popped = curr->process;
-            *rq_head = (high_head)->next;
-            free(curr);
-            return popped;
+
+// read the next process from traffic.txt or, in an open-loop run, generate it.
+// Returns NULL once all the traffic has been read
+proc_t *next_process() {
+    static char *line = NULL;
+    static size_t len = 0;
+    static int nr_generated = 0;
+    if (load) {
+        if (nr_generated >= nr_requested) {
+            return NULL;
         }
+        proc_t *proc = proc_alloc();
+        generate_process(proc, nr_generated++);
+        return proc;
     }
-    // return NULL if queue is empty
-    return NULL;
-}
-
-
-// load processes from traffic.txt into the appropriate runqueues
-void load_processes(FILE *f) {
-    char *line = NULL;
-    size_t len = 0;
-    while (getline(&line, &len, f) != -1) {
+    while (getline(&line, &len, traffic) != -1) {
         if (line[0] != '/' && line[1] != '/') {                     // if line is not a comment
             // create a process with fields from traffic.txt
-            proc_t *proc = malloc(sizeof(proc_t));
-            sscanf(line, "%d %d %d %d %d",
+            proc_t *proc = proc_alloc();
+            sscanf(line, "%d %hd %hd %hd %hhd",
                    &proc->id,
                    &proc->cpu_burst,
                    &proc->io_burst,
                    &proc->reps,
                    &proc->priority);
-            // set state to 'ready-to-run' and add to appropriate queue
-            proc->state = READY;
-            switch (sched_alg_index) {
-                case 0:
-                    push_to_runqueue(proc, &high_head, &high_tail);
-                    break;
-                case 1:
-                    push(proc);
-                    break;
-                default:
-                    break;
-            }
-            nr_processes++;
+            return proc;
         }
     }
+    fclose(traffic);
+    traffic = NULL;
+    free(line);
+    line = NULL;
+    return NULL;
+}
 
-    // array of processes - add each process
-    processes = malloc(nr_processes * sizeof(proc_t));
-
-    node_t *curr = *&high_head;
-    int i = 0;
-    while (curr) {
-        processes[i++] = curr->process;
-        curr = curr->next;
-    }
-    curr = *&med_head;
-    while (curr) {
-        processes[i++] = curr->process;
-        curr = curr->next;
+// load processes into the appropriate runqueues. Reads until the traffic is
+// exhausted, the next process has not arrived yet, or 'max_live' processes are
+// resident, so this is called again each tick to admit new arrivals and refill
+// slots freed by terminated processes
+void load_processes() {
+    static proc_t *next_proc = NULL;    // read but not yet arrived
+    while (!traffic_exhausted && (!max_live || nr_live < max_live)) {
+        if (!next_proc && !(next_proc = next_process())) {
+            traffic_exhausted = 1;
+            break;
+        }
+        if (next_proc->arrival_time > time_elapsed) {
+            break;
+        }
+        proc_t *proc = next_proc;
+        next_proc = NULL;
+
+        // set state to 'ready-to-run' and add to appropriate queue. Time spent
+        // waiting for admission under 'max_live' counts as waiting time
+        proc->state = READY;
+        proc->wait_time = time_elapsed - proc->arrival_time;
+        switch (sched_alg_index) {
+            case 0:
+                push_to_runqueue(proc, &high_head, &high_tail);
+                break;
+            case 1:
+                push(proc);
+                break;
+            default:
+                break;
+        }
+        // array of resident processes - add this process
+        if (nr_live == processes_cap) {
+            processes_cap = processes_cap ? 2 * processes_cap : (max_live ? max_live : 64);
+            processes = realloc(processes, processes_cap * sizeof(proc_t *));
+        }
+        processes[nr_live++] = proc;
+        nr_processes++;
     }
-    curr = *&low_head;
-    while (curr) {
-        processes[i++] = curr->process;
-        curr = curr->next;
+}
+
+// move a finished process to the terminated state and fold it into the
+// report totals. Its slot is reclaimed on the next sweep of 'processes'
+void terminate(proc_t *proc) {
+    proc->state = TERMINATED;
+    finished_processes++;
+    // open-loop runs only measure processes arriving after the warm-up
+    if (proc->arrival_time >= warmup) {
+        record_process(&stats, proc);
+        if (load && record_batch(&batches, proc, cpu_in_use, cpu_idle)) {
+            converged = batches_converged(&batches, precision);
+        }
     }
 }
 
@@ -213,10 +260,6 @@ proc_t *context_switch() {
                 // RUN this process
                 next_proc->state = RUNNING;
 
-                if (!next_proc->start_time) {
-                    next_proc->start_time = time_elapsed;
-                }
-
                 if (next_proc->burst_countdown <= 0) {
                     next_proc->burst_countdown = next_proc->cpu_burst;
                     next_proc->reps--;
@@ -228,10 +271,6 @@ proc_t *context_switch() {
                 // RUN this process
                 next_proc->state = RUNNING;
 
-                if (!next_proc->start_time) {
-                    next_proc->start_time = time_elapsed;
-                }
-
                 if (next_proc->burst_countdown <= 0) {
                     next_proc->burst_countdown = next_proc->cpu_burst;
                     next_proc->reps--;
@@ -253,6 +292,13 @@ proc_t *context_switch() {
 void run_FCFS() {
     printf("RUNNING FCFS...\n");
     while (1) {
+        // start measuring once the warm-up period is over
+        if (time_elapsed == warmup) {
+            warmup_busy = cpu_in_use;
+            warmup_idle = cpu_idle;
+            warmup_switches = context_switches;
+            start_batches(&batches, batch_size, cpu_in_use, cpu_idle);
+        }
         if (live_proc) {
             live_proc->burst_countdown -= 1;
 
@@ -263,8 +309,7 @@ void run_FCFS() {
                 if (live_proc->reps <= 0) {
                     // if process complete, send to terminated state and increase
                     // number of finished processes
-                    live_proc->state = TERMINATED;
-                    finished_processes += 1;
+                    terminate(live_proc);
                 } else {
                     // if process incomplete, send to waiting state and reset io countdown
                     live_proc->state = WAITING;
@@ -280,15 +325,15 @@ void run_FCFS() {
                 context_switches++;
             }
         }
-        // check if any processes have finished io countdown
-        for (int i = 0; i < nr_processes; i++) {
+        // check if any processes have finished io countdown, and compact
+        // terminated processes out of the resident set
+        int live = 0;
+        for (int i = 0; i < nr_live; i++) {
             proc_t *proc = processes[i];
             if (proc->state == WAITING) {
                 if ((proc->io_countdown -= 1) <= 0 ) {
                     if (proc->reps <= 0) {
-                        proc->state = TERMINATED;
-                        proc->end_time = time_elapsed;
-                        finished_processes++;
+                        terminate(proc);
                     } else {
                         proc->state = READY;
                         proc->wait_time += 1;
@@ -298,23 +343,46 @@ void run_FCFS() {
             } else if (proc->state == READY) {
                 proc->wait_time += 1;
             }
+            if (proc->state == TERMINATED) {
+                proc_release(proc);
+            } else {
+                processes[live++] = proc;
+            }
+        }
+        nr_live = live;
+        // admit waiting traffic into any freed slots
+        load_processes();
+        // break if all processes are finished, or once an open-loop run has converged
+        if (finished_processes >= nr_processes && traffic_exhausted) {
+            break;
         }
-        // break if all processes are finished
-        if (finished_processes >= nr_processes) {
+        if (converged) {
             break;
         }
         // increment total runtime
         time_elapsed++;
     }
-    report(cpu_in_use, cpu_idle, context_switches, nr_processes, processes);
+    if (load && !converged) {
+        printf("   Traffic exhausted before convergence: intervals are wider than requested\n");
+    }
+    report(cpu_in_use - warmup_busy, cpu_idle - warmup_idle, context_switches - warmup_switches,
+           &stats, load ? &batches : NULL);
     // free all the mem
-    for (int i = 0; i < nr_processes; i++) free(processes[i]);
+    free(processes);
+    proc_pool_destroy();
 }
 
 // Round-Robin simulation
 void run_RR() {
     printf("RUNNING RR...\n");
     while (1) {
+        // start measuring once the warm-up period is over
+        if (time_elapsed == warmup) {
+            warmup_busy = cpu_in_use;
+            warmup_idle = cpu_idle;
+            warmup_switches = context_switches;
+            start_batches(&batches, batch_size, cpu_in_use, cpu_idle);
+        }
         if (live_proc) {
             live_proc->burst_countdown -= 1;
             live_proc->quantum_countdown -= 1;
@@ -327,8 +395,7 @@ void run_RR() {
                 if (live_proc->reps <= 0) {
                     // if process complete, send to terminated state and increase
                     // number of finished processes
-                    live_proc->state = TERMINATED;
-                    finished_processes += 1;
+                    terminate(live_proc);
                 } else {
                     // if process incomplete, send to waiting state and reset io countdown
                     live_proc->state = WAITING;
@@ -351,15 +418,15 @@ void run_RR() {
                 context_switches++;
             }
         }
-        // check if any processes have finished io countdown
-        for (int i = 0; i < nr_processes; i++) {
+        // check if any processes have finished io countdown, and compact
+        // terminated processes out of the resident set
+        int live = 0;
+        for (int i = 0; i < nr_live; i++) {
             proc_t *proc = processes[i];
             if (proc->state == WAITING) {
                 if ((proc->io_countdown -= 1) <= 0 ) {
                     if (proc->reps <= 0) {
-                        proc->state = TERMINATED;
-                        proc->end_time = time_elapsed;
-                        finished_processes++;
+                        terminate(proc);
                     } else {
                         proc->state = READY;
                         proc->wait_time += 1;
@@ -369,17 +436,33 @@ void run_RR() {
             } else if (proc->state == READY) {
                 proc->wait_time += 1;
             }
+            if (proc->state == TERMINATED) {
+                proc_release(proc);
+            } else {
+                processes[live++] = proc;
+            }
         }
-        // break if all processes are finished
-        if (finished_processes >= nr_processes) {
+        nr_live = live;
+        // admit waiting traffic into any freed slots
+        load_processes();
+        // break if all processes are finished, or once an open-loop run has converged
+        if (finished_processes >= nr_processes && traffic_exhausted) {
+            break;
+        }
+        if (converged) {
             break;
         }
         // increment total runtime
         time_elapsed++;
     }
-    report(cpu_in_use, cpu_idle, context_switches, nr_processes, processes);
+    if (load && !converged) {
+        printf("   Traffic exhausted before convergence: intervals are wider than requested\n");
+    }
+    report(cpu_in_use - warmup_busy, cpu_idle - warmup_idle, context_switches - warmup_switches,
+           &stats, load ? &batches : NULL);
     // free all the mem
-    for (int i = 0; i < nr_processes; i++) free(processes[i]);
+    free(processes);
+    proc_pool_destroy();
 }
 
 // Shortest-Job-First Simulation
@@ -390,9 +473,62 @@ void run_SJF() {
 
 int main(int argc, char *argv[]) {
 
+    // parse open-loop options
+    int opt;
+    while ((opt = getopt(argc, argv, "l:a:w:e:b:s:")) != -1) {
+        switch (opt) {
+            case 'l':
+                // at or above 1 the runqueues grow without bound and never settle
+                if (!parse_double(optarg, &load) || load <= 0 || load >= 1) {
+                    fprintf(stderr, "Target load must be greater than 0 and less than 1\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'a':
+                if (strcmp(optarg, "poisson") == 0) {
+                    arrivals = ARRIVALS_POISSON;
+                } else if (strcmp(optarg, "mmpp") == 0) {
+                    arrivals = ARRIVALS_MMPP;
+                } else {
+                    fprintf(stderr, "Invalid arrival process. Try \"poisson\" or \"mmpp\"\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'w':
+                if (!parse_long(optarg, &warmup) || warmup < 0) {
+                    fprintf(stderr, "Warm-up must be a number of ticks, 0 or more\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'e':
+                if (!parse_double(optarg, &precision) || precision <= 0) {
+                    fprintf(stderr, "Precision must be a positive number\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'b':
+                if (!parse_double(optarg, &burstiness) || burstiness < 0 || burstiness >= 1) {
+                    fprintf(stderr, "MMPP burstiness must be at least 0 and less than 1\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 's':
+                if (!parse_double(optarg, &sojourn) || sojourn <= 0) {
+                    fprintf(stderr, "MMPP sojourn must be a positive number\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            default:
+                exit(EXIT_FAILURE);
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
     // validate command line args
-    if (argc != 3) {
-        fprintf(stderr, "Usage: $ ./<executable> <algorithm> <number of processes>");
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: $ ./<executable> [-l <target load> [-a poisson|mmpp] [-w <warm-up ticks>] "
+                        "[-e <precision>] [-b <MMPP burstiness>] [-s <MMPP sojourn>]] <algorithm> <number of processes> [<max admitted processes>]");
         exit(EXIT_FAILURE);
     }
     sched_alg = argv[1];
@@ -404,14 +540,60 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    // generate sample traffic for the scheduler
-    generate_traffic(atoi(argv[2]));
+    long count;
+    if (!parse_long(argv[2], &count) || count <= 0 || count > INT_MAX) {
+        fprintf(stderr, "Number of processes must be a positive integer\n");
+        exit(EXIT_FAILURE);
+    }
+    nr_requested = (int) count;
+
+    // optionally limit the number of processes admitted at once. This changes the
+    // system simulated: processes waiting for admission hold no runqueue position
+    if (argc == 4) {
+        if (!parse_long(argv[3], &count) || count <= 0 || count > INT_MAX) {
+            fprintf(stderr, "Max admitted processes must be a positive integer\n");
+            exit(EXIT_FAILURE);
+        }
+        max_live = (int) count;
+    }
+
+    // a target load switches from a single batch arriving at time zero to
+    // open-loop arrivals, measured after a warm-up until the averages converge
+    if (!load) {
+        if (arrivals != ARRIVALS_BATCH || warmup >= 0 || precision >= 0
+            || burstiness >= 0 || sojourn >= 0) {
+            fprintf(stderr, "Open-loop options (-a, -w, -e, -b, -s) need a target load (-l)\n");
+            exit(EXIT_FAILURE);
+        }
+        warmup = 0;
+    } else {
+        if (arrivals != ARRIVALS_MMPP && (burstiness >= 0 || sojourn >= 0)) {
+            fprintf(stderr, "Burstiness and sojourn only apply to MMPP arrivals (-a mmpp)\n");
+            exit(EXIT_FAILURE);
+        }
+        if (arrivals == ARRIVALS_BATCH) arrivals = ARRIVALS_POISSON;
+        if (warmup < 0) warmup = WARMUP;
+        if (precision < 0) precision = PRECISION;
+        if (burstiness < 0) burstiness = MMPP_BURSTINESS;
+        if (sojourn < 0) sojourn = MMPP_SOJOURN;
+        // batches span several MMPP busy/quiet cycles to start with
+        if (arrivals == ARRIVALS_MMPP && 20 * sojourn > batch_size) {
+            batch_size = (long) (20 * sojourn);
+        }
+    }
 
-    // read traffic and load processes
-    FILE *fp;
-    fp = fopen("traffic.txt", "r");
-    load_processes(fp);
-    fclose(fp);
+    // open-loop runs generate processes as they arrive, since the run may stop
+    // long before all of them are needed; otherwise generate sample traffic for
+    // the scheduler and read it back
+    start_arrivals(arrivals, load, sched_alg_index == 1 ? QUANTUM : 0, burstiness, sojourn);
+    if (!load) {
+        generate_traffic(nr_requested);
+        if (!(traffic = fopen("traffic.txt", "r"))) {
+            fprintf(stderr, "Failed to read traffic (error opening file \"traffic.txt\")\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    load_processes();
 
     // run according to the selected scheduling algorithm
     switch (sched_alg_index) {
@@ -4,12 +4,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include "traffic_generator.h"
 
+#define CPU_BURST_RANGE     530
+#define REPS_RANGE          100
 
-unsigned int generate_cpu_burst() {
-    // generate a random number between 0 and 530
-    unsigned int r = arc4random() % 530;
+
+// map a draw r in [0, CPU_BURST_RANGE) to a burst time
+static unsigned int cpu_burst_from(unsigned int r) {
     // assign burst time depending on r: note on distribution
     int burst;
     if (r < 150) {
@@ -40,6 +43,11 @@ unsigned int generate_cpu_burst() {
     return burst;
 }
 
+unsigned int generate_cpu_burst() {
+    // generate a random number between 0 and 530
+    return cpu_burst_from(arc4random() % CPU_BURST_RANGE);
+}
+
 unsigned int generate_io_burst(unsigned int cpu_burst) {
     // generate random number
     unsigned int r = arc4random() % 100;
@@ -52,8 +60,8 @@ unsigned int generate_io_burst(unsigned int cpu_burst) {
     return io_burst;
 }
 
-unsigned int generate_reps(unsigned int cpu_burst) {
-    unsigned int r = arc4random() % 100;
+// map a draw r in [0, REPS_RANGE) to a repetition count
+static unsigned int reps_from(unsigned int cpu_burst, unsigned int r) {
     unsigned int reps;
     if (cpu_burst > 8) {
         reps = (r / 20) + 1;
@@ -63,6 +71,10 @@ unsigned int generate_reps(unsigned int cpu_burst) {
     return reps;
 }
 
+unsigned int generate_reps(unsigned int cpu_burst) {
+    return reps_from(cpu_burst, arc4random() % REPS_RANGE);
+}
+
 unsigned int assign_priority(unsigned int cpu_burst) {
     unsigned int priority;
     unsigned int r = arc4random() % 10;
@@ -74,6 +86,103 @@ unsigned int assign_priority(unsigned int cpu_burst) {
     return priority;
 }
 
+// ticks a process keeps the CPU busy: the scheduler spends two repetitions
+// per burst, one on dispatch and one on completion
+static unsigned int service_demand(unsigned int cpu_burst, unsigned int reps) {
+    unsigned int bursts = (reps + 1) / 2;
+    return bursts * cpu_burst;
+}
+
+// dispatches a process needs: one per burst, plus one per preemption when bursts
+// are sliced into quanta (a quantum of 0 means bursts run to completion)
+static unsigned int dispatches(unsigned int cpu_burst, unsigned int reps, unsigned int quantum) {
+    unsigned int bursts = (reps + 1) / 2;
+    return bursts * (quantum ? (cpu_burst + quantum - 1) / quantum : 1);
+}
+
+static int arrival_process = ARRIVALS_BATCH;
+static double mean_interarrival;
+static double mmpp_burstiness;
+static double mmpp_sojourn;
+static double arrival_clock;
+static int busy_phase = 1;
+static double phase_end = -1;
+
+// exponentially distributed variate with the given mean
+static double generate_exponential(double mean) {
+    // uniform on (0, 1], so the log is finite
+    double u = (arc4random() + 1.0) / 4294967296.0;
+    return -mean * log(u);
+}
+
+// configure the arrivals of generate_process(). report() measures utilisation as
+// busy / (busy + idle), and dispatch ticks count as neither, so with B busy and
+// D dispatch ticks per process on average, an arrival every B / load + D ticks
+// makes report() measure 'load'. The MMPP phase rates are (1 +/- 'burstiness')
+// times the mean, and each phase lasts 'sojourn' mean interarrival times on average
+void start_arrivals(int arrivals, double load, unsigned int quantum,
+                    double burstiness, double sojourn) {
+    arrival_process = arrivals;
+    mmpp_burstiness = burstiness;
+    mmpp_sojourn = sojourn;
+    arrival_clock = 0;
+    if (arrivals == ARRIVALS_BATCH) {
+        return;
+    }
+    // exact means over the generator's distributions
+    double busy = 0, dispatch = 0;
+    for (unsigned int r = 0; r < CPU_BURST_RANGE; r++) {
+        unsigned int cpu_burst = cpu_burst_from(r);
+        for (unsigned int s = 0; s < REPS_RANGE; s++) {
+            unsigned int reps = reps_from(cpu_burst, s);
+            busy += service_demand(cpu_burst, reps);
+            dispatch += dispatches(cpu_burst, reps, quantum);
+        }
+    }
+    busy /= (double) CPU_BURST_RANGE * REPS_RANGE;
+    dispatch /= (double) CPU_BURST_RANGE * REPS_RANGE;
+    mean_interarrival = busy / load + dispatch;
+}
+
+// advance the arrival clock to the next arrival. Poisson arrivals have a fixed
+// rate; the MMPP alternates between a busy and a quiet phase
+static void next_arrival() {
+    if (arrival_process == ARRIVALS_POISSON) {
+        arrival_clock += generate_exponential(mean_interarrival);
+        return;
+    }
+    if (phase_end < 0) {
+        phase_end = generate_exponential(mmpp_sojourn * mean_interarrival);
+    }
+    while (1) {
+        double rate = (busy_phase ? 1 + mmpp_burstiness : 1 - mmpp_burstiness) / mean_interarrival;
+        double t = arrival_clock + generate_exponential(1 / rate);
+        if (t <= phase_end) {
+            arrival_clock = t;
+            return;
+        }
+        // no arrival before the phase switch: exponentials are memoryless, so
+        // restart the draw from the switch in the other phase
+        arrival_clock = phase_end;
+        busy_phase = !busy_phase;
+        phase_end = arrival_clock + generate_exponential(mmpp_sojourn * mean_interarrival);
+    }
+}
+
+// fill in a new process with random bursts and priority, arriving at the
+// next time drawn from the arrivals set up by start_arrivals()
+void generate_process(proc_t *proc, int id) {
+    proc->id = id;
+    proc->cpu_burst = generate_cpu_burst();
+    proc->io_burst = generate_io_burst(proc->cpu_burst);
+    proc->reps = generate_reps(proc->cpu_burst);
+    proc->priority = assign_priority(proc->cpu_burst);
+    if (arrival_process != ARRIVALS_BATCH) {
+        next_arrival();
+    }
+    proc->arrival_time = (long) arrival_clock;
+}
+
 int generate_traffic(unsigned int nr_processes) {
     FILE *fp;
     if (!(fp = fopen("traffic.txt", "w"))) {
@@ -81,13 +190,10 @@ int generate_traffic(unsigned int nr_processes) {
         exit(EXIT_FAILURE);
     }
     fprintf(fp, "// PID | CPU burst | IO burst | Repetitions | Priority\n");
-    unsigned int cpu_burst, io_burst, reps, priority;
+    proc_t proc;
     for (int i = 0; i < nr_processes; i++) {
-        cpu_burst = generate_cpu_burst();
-        io_burst = generate_io_burst(cpu_burst);
-        reps = generate_reps(cpu_burst);
-        priority = assign_priority(cpu_burst);
-        fprintf(fp, "%d %d %d %d %d\n", i, cpu_burst, io_burst, reps, priority);
+        generate_process(&proc, i);
+        fprintf(fp, "%d %d %d %d %d\n", proc.id, proc.cpu_burst, proc.io_burst, proc.reps, proc.priority);
     }
     fclose(fp);
     return 1;
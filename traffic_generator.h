@@ -5,10 +5,24 @@
 #ifndef SCHEDULER_TRAFFIC_GENERATOR_H
 #define SCHEDULER_TRAFFIC_GENERATOR_H
 
+#include "reporter.h"
+
+// arrival processes
+#define ARRIVALS_BATCH      0   // every process arrives at time zero
+#define ARRIVALS_POISSON    1
+#define ARRIVALS_MMPP       2   // two-phase Markov-modulated Poisson process
+
+// default MMPP shape
+#define MMPP_BURSTINESS     0.5 // phase rates are (1 +/- this) times the mean rate
+#define MMPP_SOJOURN        100 // mean phase length, in mean interarrival times
+
 unsigned int generate_cpu_burst();
 unsigned int generate_io_burst(unsigned int cpu_burst);
 unsigned int generate_reps(unsigned int cpu_burst);
 unsigned int assign_priority(unsigned int cpu_burst);
+void start_arrivals(int arrivals, double load, unsigned int quantum,
+                    double burstiness, double sojourn);
+void generate_process(proc_t *proc, int id);
 int generate_traffic(unsigned int nr_processes);
 
 #endif //SCHEDULER_TRAFFIC_GENERATOR_H